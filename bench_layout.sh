@@ -0,0 +1,38 @@
+#!/bin/bash
+# Compare the default global layout of detect_spr and detect_spr_list
+# against the isolated (cache line / page, prefaulted and mlocked) layouts.
+# The isolated binaries exit with an error if mlockall fails; such runs are
+# reported as FAILED instead of being averaged in.
+#
+# usage: ./bench_layout.sh [runs] [detect_spr options]
+RUNS=${1:-5}
+shift
+
+BINS="detect_spr detect_spr_line detect_spr_page
+      detect_spr_list detect_spr_list_line detect_spr_list_page"
+make -s $BINS || exit 1
+
+printf "%-22s %10s %10s %10s %14s\n" layout "noise0" "noise1" "error(%)" "samples/s"
+for bin in $BINS; do
+    out=$(for i in $(seq $RUNS); do
+              ./$bin "$@" 2> /dev/null || echo "RUN FAILED"
+              echo "END OF RUN"
+          done | sed 's/\x1b\[[0-9;]*m//g')
+    if echo "$out" | grep -q "RUN FAILED"; then
+        printf "%-22s FAILED: %s\n" $bin \
+            "$(echo "$out" | grep -m1 '^\[-\] mlockall' | sed 's/^\[-\] //')"
+        continue
+    fi
+    echo "$out" | awk -v bin=$bin -v runs=$RUNS '
+        BEGIN { e0 = e1 = 100 }
+        /Send 0 noise/ { n0 += $(NF-1) }
+        /Send 1 noise/ { n1 += $(NF-1) }
+        # "Error rate" is only printed if both directions have errors; the
+        # per-direction lines are missing only if all samples were wrong
+        /\] 0 - Error count/ { sub("%", "", $NF); e0 = $NF }
+        /\] 1 - Error count/ { sub("%", "", $NF); e1 = $NF }
+        /END OF RUN/ { err += (e0 + e1) / 2; e0 = e1 = 100 }
+        /Sample rate/ { rate += $(NF-1) }
+        END { printf "%-22s %10.2f %10.2f %10.2f %14.0f\n", bin,
+              n0/runs, n1/runs, err/runs, rate/runs }'
+done
@@ -29,6 +29,7 @@
 #include <signal.h>
 #include <stdarg.h>
 #include <stdlib.h>
+#include <math.h>
 #include <unistd.h>
 #include <time.h>
 #include <inttypes.h>
@@ -43,6 +44,19 @@
  **************************************************************************/
 #define N_DIVS 12   // determine speculative execution length
 
+/*
+ * Build with -DISOLATE_LAYOUT=<bytes> (64: cache line, 4096: page) to give
+ * each piece of gadget state its own slot, and to prefault and mlock all
+ * memory before measuring. Every global of this file is aligned to a slot,
+ * so no other variable can be placed in the tail of a gadget variable's
+ * slot. The default build keeps the ordinary globals.
+ */
+#if defined(ISOLATE_LAYOUT)
+#define ISOLATED __attribute__ ((aligned (ISOLATE_LAYOUT)))
+#else
+#define ISOLATED
+#endif
+
 /**************************************************************************
  * Public Types
  **************************************************************************/
@@ -53,12 +67,12 @@ typedef struct {
 /**************************************************************************
  * Global Variables
  **************************************************************************/
-static int dbg = 1;
-static volatile uint64_t counter = 0;
-static libkdump_config_t config;
+static int dbg ISOLATED = 1;
+static volatile uint64_t counter ISOLATED = 0; // written by the counter thread
+static libkdump_config_t config ISOLATED;
 typedef enum { ERROR, INFO, SUCCESS } d_sym_t;
-static pthread_t count_thread;
-static int g_bp_depth = 9;
+static pthread_t count_thread ISOLATED;
+static int g_bp_depth ISOLATED = 9;
 
 /**************************************************************************
  * Public Function Prototypes
@@ -114,13 +128,13 @@ static inline uint64_t rdtsc() {
 }
 #endif
 
-volatile char zero = 0;
-volatile char ones = 0xff;
+volatile char zero ISOLATED = 0;
+volatile char ones ISOLATED = 0xff;
 
-double my_number1 = 123456778910;
-double my_number2 = 123456778910;
-double my_number3 = 123456778910;
-double my_number4 = 123456778910;
+double my_number1 ISOLATED = 123456778910;
+double my_number2 ISOLATED = 123456778910;
+double my_number3 ISOLATED = 123456778910;
+double my_number4 ISOLATED = 123456778910;
 
 struct div_test
 {
@@ -129,10 +143,10 @@ struct div_test
   volatile char *addr;
 };
 
-struct div_test trainer;
-struct div_test transmit_0;
-struct div_test transmit_1;
-struct div_test transmit;
+struct div_test trainer ISOLATED;
+struct div_test transmit_0 ISOLATED;
+struct div_test transmit_1 ISOLATED;
+struct div_test transmit ISOLATED;
 
 /* 
  * micro arch.   minimum # training runs
@@ -145,7 +159,7 @@ struct div_test transmit;
  * all others    7
  * default       9 (works on all tested platforms)
  */ 
-struct div_test *test_tasks[20];
+struct div_test *test_tasks[20] ISOLATED;
 
 int __attribute__ ((noinline)) transmit_bit( struct div_test * dt, int bit_no )
 {
@@ -182,8 +196,8 @@ int __attribute__ ((noinline)) transmit_bit( struct div_test * dt, int bit_no )
 
 #define N_TESTS 1000000
 #define MAX_CYCLES 1024
-static int histo[3][MAX_CYCLES];
-static int total[3][N_TESTS];
+static int histo[3][MAX_CYCLES] ISOLATED;
+static int total[3][N_TESTS] ISOLATED;
 
 static int comparator(const void *p, const void *q)
 {
@@ -197,6 +211,39 @@ uint64_t now_in_ns()
   return ((uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec);
 }
 
+#if defined(ISOLATE_LAYOUT)
+static void prefault(volatile void *p, size_t len)
+{
+  for (size_t i = 0; i < len; i += 4096)
+    ((volatile char *)p)[i] = ((volatile char *)p)[i];
+  ((volatile char *)p)[len - 1] = ((volatile char *)p)[len - 1];
+}
+
+// Fault in everything the measurement loop touches and pin it, so that no
+// page fault lands inside a timed transmit_bit() call.
+static int __attribute__((noinline)) lock_memory()
+{
+  volatile char stack[64 * 1024];
+
+  prefault(&counter, sizeof(counter));
+  prefault(&zero, sizeof(zero));
+  prefault(&ones, sizeof(ones));
+  prefault(&my_number1, sizeof(my_number1));
+  prefault(&my_number2, sizeof(my_number2));
+  prefault(&my_number3, sizeof(my_number3));
+  prefault(&my_number4, sizeof(my_number4));
+  prefault(&trainer, sizeof(trainer));
+  prefault(&transmit_0, sizeof(transmit_0));
+  prefault(&transmit_1, sizeof(transmit_1));
+  prefault(test_tasks, sizeof(test_tasks));
+  prefault(histo, sizeof(histo));
+  prefault(total, sizeof(total));
+  prefault(stack, sizeof(stack));
+
+  return mlockall(MCL_CURRENT | MCL_FUTURE);
+}
+#endif
+
 static void *countthread(void *dummy) {
   uint64_t local_counter = 0;
   while (1) {
@@ -259,6 +306,15 @@ static void __attribute__((optimize("-O2"), noinline)) detect_spectrerewind_thre
     debug(INFO, "Send %d timing (min, 1pct, median, 99pct, max): (%4d, %4d, %4d, %4d, %4d)\n", i,
           total[i][0], total[i][N_TESTS*1/100], total[i][N_TESTS/2],
           total[i][N_TESTS*99/100], total[i][N_TESTS-1]);
+
+    // noise: spread of the samples within the 1-99 percentile range
+    double sum = 0, sq = 0;
+    int n = N_TESTS*99/100 - N_TESTS*1/100;
+    for (int j = N_TESTS*1/100; j < N_TESTS*99/100; j++)
+      sum += total[i][j];
+    for (int j = N_TESTS*1/100; j < N_TESTS*99/100; j++)
+      sq += (total[i][j] - sum / n) * (total[i][j] - sum / n);
+    debug(INFO, "Send %d noise (stddev): %.2f cycles\n", i, sqrt(sq / n));
   }
   
   if (total[0][N_TESTS*99/100] < total[1][N_TESTS*1/100]) {
@@ -285,6 +341,7 @@ static void __attribute__((optimize("-O2"), noinline)) detect_spectrerewind_thre
   }
 
   debug(INFO, "Transfer rate: %.2f KB/s\n", (double) 2 * N_TESTS * 1000000 / 8 / (bw_end - bw_start) );
+  debug(INFO, "Sample rate: %.0f samples/s\n", (double) 2 * N_TESTS * 1000000000 / (bw_end - bw_start) );
   if (dbg){
     for(int i = 0; i < MAX_CYCLES; i++) {
       fprintf(stderr, "%d\t%0.5f\t%0.5f\t%0.5f\n", i,
@@ -319,6 +376,15 @@ int main(int argc, char *argv[])
   }
   debug(INFO, "Done: %ld\n", counter);
 #endif
+#if defined(ISOLATE_LAYOUT)
+  // after the counter thread exists, so that its stack is locked as well
+  // and MCL_FUTURE cannot make pthread_create() fail
+  debug(INFO, "Isolated layout: %d bytes per slot\n", ISOLATE_LAYOUT);
+  if (lock_memory() < 0) {
+    debug(ERROR, "mlockall failed: %s (raise ulimit -l or run as root)\n", strerror(errno));
+    return -1;
+  }
+#endif
 
   detect_spectrerewind_threshold();
 
@@ -0,0 +1,985 @@
+/**
+ * SpectreRewind gadget scanner
+ *
+ * Copyright (C) 2020 Computer Systems Lab, University of Kansas.
+ *
+ * Statically scans the executable sections of ELF binaries for code
+ * shaped like transmit_bit() in detect_spr.c and detect_spr_list.c:
+ *
+ *   1. a conditional branch (the guard) whose condition depends on a
+ *      long-latency chain of divides or dependent loads,
+ *   2. a load shortly after the guard (the secret access), and
+ *   3. a burst of non-pipelined divides or dependent loads after the
+ *      secret access (the contention that leaks to past instructions).
+ *
+ * Disassembly is done by objdump(1). Text is split into chunks at
+ * function boundaries and the chunks are disassembled and analyzed by
+ * a pool of worker threads.
+ *
+ * This file is distributed under the GPLv2 License.
+ */
+
+/**************************************************************************
+ * Conditional Compilation Options
+ **************************************************************************/
+#define _GNU_SOURCE             /* See feature_test_macros(7) */
+
+/**************************************************************************
+ * Included Files
+ **************************************************************************/
+#include <ctype.h>
+#include <elf.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <spawn.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+/**************************************************************************
+ * Public Definitions
+ **************************************************************************/
+#define MAX_REGS    64    // tracked register ids (gp + vector)
+#define MAX_SRCS    8     // tracked source registers per instruction
+
+#define F_DIV       0x01  // non-pipelined divide or square root
+#define F_LOAD      0x02  // memory read
+#define F_PCREL     0x04  // address is pc/rip relative (not attacker chosen)
+#define F_CBR       0x08  // conditional branch
+#define F_BACK      0x10  // branch target is at or before the branch
+#define F_CALL      0x20  // call; clobbers the taint state
+#define F_DEP       0x40  // load whose address depends on a prior load
+#define F_LOOP      0x80  // inside a tight loop (backward conditional branch)
+#define F_CARRY     0x100 // dependent load carried across loop iterations
+#define F_STACK     0x200 // stack/frame pointer relative (spill reload)
+#define F_END       0x800 // ret or unconditional jump; ends straight-line code
+
+#define TIGHT_LOOP  32    // max. # instructions in a loop body that repeats
+                          // a divide or pointer chase back to back
+
+#define MIN(a,b) (((a)<(b)) ? (a) : (b))
+#define MAX(a,b) (((a)>(b)) ? (a) : (b))
+
+/**************************************************************************
+ * Public Types
+ **************************************************************************/
+typedef enum { ARCH_X86, ARCH_ARM64 } arch_t;
+
+typedef struct {
+  int chain_min;   /**< minimum chain score (latency path into the guard) */
+  int load_win;    /**< # instructions after the guard searched for the load */
+  int burst_win;   /**< # instructions after the load searched for the burst */
+  int burst_min;   /**< minimum burst score */
+  int loop_weight; /**< score of a long-latency op inside a loop */
+  size_t chunk;    /**< bytes of text per objdump invocation */
+} scan_config_t;
+
+struct insn {
+  uint64_t addr;
+  uint64_t target;            /* branch target */
+  int flags;
+  int lat;                    /* long-latency ops on the path to the result */
+  signed char dst;            /* written register or -1 */
+  signed char nsrc;
+  signed char src[MAX_SRCS];  /* read registers, incl. address registers */
+  signed char naddr;
+  signed char addr_reg[3];    /* registers forming the load address */
+};
+
+struct job {
+  const char *path;
+  const char *section;        /* NULL: whole file (relocatable objects) */
+  uint64_t start, stop;       /* stop - start: bytes of text */
+  arch_t arch;
+  int status;                 /* 0, objdump's wait status or -1 if not run */
+};
+
+/**************************************************************************
+ * Global Variables
+ **************************************************************************/
+static int dbg = 1;
+typedef enum { ERROR, INFO, SUCCESS } d_sym_t;
+static pthread_mutex_t out_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static scan_config_t config = {
+  .chain_min   = 8,
+  .load_win    = 8,
+  .burst_win   = 48,
+  .burst_min   = 8,
+  .loop_weight = 8,
+  .chunk       = 1 << 20,
+};
+
+static struct job *jobs;
+static int n_jobs, max_jobs;
+static int next_job;
+static int n_files;
+static int n_errors;        /* unreadable paths and files objdump failed on */
+
+static uint64_t g_bytes, g_funcs, g_insns, g_hits;
+
+/**************************************************************************
+ * Public Function Prototypes
+ **************************************************************************/
+static void debug(d_sym_t symbol, const char *fmt, ...) {
+  if (!dbg && symbol != ERROR) /* -q still reports failures */
+    return;
+
+  pthread_mutex_lock(&out_lock);
+  switch (symbol) {
+  case ERROR:
+    printf("\x1b[31;1m[-]\x1b[0m ");
+    break;
+  case INFO:
+    printf("\x1b[33;1m[.]\x1b[0m ");
+    break;
+  case SUCCESS:
+    printf("\x1b[32;1m[+]\x1b[0m ");
+    break;
+  default:
+    break;
+  }
+  va_list ap;
+  va_start(ap, fmt);
+  vfprintf(stdout, fmt, ap);
+  va_end(ap);
+  pthread_mutex_unlock(&out_lock);
+}
+
+uint64_t now_in_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return ((uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec);
+}
+
+// ---------------------------------------------------------------------------
+// Register names -> ids. x86: 0-15 gp, 16-47 xmm/ymm/zmm.
+// arm64: 0-30 x/w, 31 sp, 32-63 v/q/d/s/h/b.
+static int x86_reg(const char *r, int len)
+{
+  static const char *gp[16][5] = {
+    { "rax", "eax", "ax", "al", "ah" }, { "rcx", "ecx", "cx", "cl", "ch" },
+    { "rdx", "edx", "dx", "dl", "dh" }, { "rbx", "ebx", "bx", "bl", "bh" },
+    { "rsp", "esp", "sp", "spl" },      { "rbp", "ebp", "bp", "bpl" },
+    { "rsi", "esi", "si", "sil" },      { "rdi", "edi", "di", "dil" },
+  };
+  char name[8];
+
+  if (len <= 0 || len >= (int)sizeof(name))
+    return -1;
+  memcpy(name, r, len);
+  name[len] = 0;
+
+  for (int i = 0; i < 8; i++)
+    for (int j = 0; j < 5 && gp[i][j]; j++)
+      if (!strcmp(name, gp[i][j]))
+        return i;
+  if (name[0] == 'r' && isdigit(name[1]))
+    return 8 + (atoi(name + 1) & 7);
+  if (len > 3 && !strncmp(name + 1, "mm", 2) && strchr("xyz", name[0]))
+    return 16 + (atoi(name + 3) & 31);
+  return -1;
+}
+
+static int arm64_reg(const char *r, int len)
+{
+  char *end;
+  long n;
+
+  if (len == 2 && !strncmp(r, "sp", 2))
+    return 31;
+  if (len == 3 && !strncmp(r, "wsp", 3))
+    return 31;
+  if (len < 2 || !strchr("xwvqdshb", r[0]) || !isdigit(r[1]))
+    return -1;
+  n = strtol(r + 1, &end, 10);
+  if (n > 31 || (end - r != len && *end != '.'))
+    return -1;
+  if (r[0] == 'x' || r[0] == 'w')
+    return n == 31 ? -1 : n;
+  return 32 + n;
+}
+
+// ---------------------------------------------------------------------------
+// Split the operand field at top-level commas. Returns # operands.
+static int split_ops(char *s, char **ops, int max)
+{
+  int n = 0, depth = 0;
+
+  while (isspace(*s))
+    s++;
+  if (!*s)
+    return 0;
+  ops[n++] = s;
+  for (; *s; s++) {
+    if (*s == '(' || *s == '[' || *s == '{')
+      depth++;
+    else if (*s == ')' || *s == ']' || *s == '}')
+      depth--;
+    else if (*s == ',' && depth == 0 && n < max) {
+      *s = 0;
+      ops[n++] = s + 1;
+      while (isspace(*ops[n-1]))
+        ops[n-1]++;
+    }
+  }
+  return n;
+}
+
+static void add_src(struct insn *in, int reg)
+{
+  if (reg >= 0 && in->nsrc < MAX_SRCS)
+    in->src[in->nsrc++] = reg;
+}
+
+static int prefix(const char *s, const char *p)
+{
+  return !strncmp(s, p, strlen(p));
+}
+
+// AT&T syntax: "mnemonic src,...,dst"
+static void decode_x86(struct insn *in, char *mn, char *opstr)
+{
+  char *ops[6];
+  int nops, mem = -1, movlike, cmplike, reg;
+
+  if (prefix(mn, "div") || prefix(mn, "idiv") || prefix(mn, "vdiv") ||
+      prefix(mn, "fdiv") || prefix(mn, "fidiv") || prefix(mn, "sqrt") ||
+      prefix(mn, "vsqrt") || !strcmp(mn, "fsqrt"))
+    in->flags |= F_DIV;
+  if (prefix(mn, "call"))
+    in->flags |= F_CALL;
+
+  nops = split_ops(opstr, ops, 6);
+
+  if (prefix(mn, "ret") || prefix(mn, "jmp") || !strcmp(mn, "ud2") ||
+      !strcmp(mn, "hlt"))
+    in->flags |= F_END;
+
+  if (mn[0] == 'j' || prefix(mn, "loop")) {
+    if (!prefix(mn, "jmp"))
+      in->flags |= F_CBR;
+    if (nops == 1 && isxdigit(ops[0][0]))
+      in->target = strtoull(ops[0], NULL, 16);
+    if (in->target && in->target <= in->addr)
+      in->flags |= F_BACK;
+    return;
+  }
+
+  for (int i = 0; i < nops; i++) {
+    char *p = strchr(ops[i], '(');
+    if (!p || prefix(ops[i], "%st")) /* x87 %st(1) is a register */
+      continue;
+    mem = i;
+    if (strstr(p, "%rip") || strstr(p, "%eip"))
+      in->flags |= F_PCREL;
+    while ((p = strchr(p, '%')) != NULL) {
+      int len = strcspn(++p, ",)");
+      reg = x86_reg(p, len);
+      if (reg >= 0 && in->naddr < 3)
+        in->addr_reg[in->naddr++] = reg;
+      add_src(in, reg);
+    }
+  }
+  if (in->naddr == 1 && in->addr_reg[0] == 4) /* %rsp */
+    in->flags |= F_STACK;
+
+  if (mem >= 0 && !prefix(mn, "lea") && !prefix(mn, "nop") &&
+      !prefix(mn, "prefetch") && !prefix(mn, "clflush") &&
+      !prefix(mn, "call") && !prefix(mn, "jmp")) {
+    if (mem != nops - 1 || prefix(mn, "cmp") || prefix(mn, "test") ||
+        prefix(mn, "bt") || (nops == 1 && (prefix(mn, "push") ||
+        prefix(mn, "div") || prefix(mn, "idiv") || prefix(mn, "mul") ||
+        prefix(mn, "imul") || prefix(mn, "fld") || prefix(mn, "fild") ||
+        prefix(mn, "fdiv"))))
+      in->flags |= F_LOAD;
+  }
+
+  cmplike = prefix(mn, "cmp") || prefix(mn, "test") || prefix(mn, "bt") ||
+    prefix(mn, "ucomis") || prefix(mn, "comis") || prefix(mn, "vucomis") ||
+    prefix(mn, "vcomis") || prefix(mn, "push");
+  movlike = prefix(mn, "mov") || prefix(mn, "vmov") || prefix(mn, "lea") ||
+    prefix(mn, "cvt") || prefix(mn, "vcvt") || prefix(mn, "pop");
+
+  for (int i = 0; i < nops; i++) {
+    if (ops[i][0] != '%')
+      continue;
+    reg = x86_reg(ops[i] + 1, strlen(ops[i] + 1));
+    if (i == nops - 1 && !cmplike) {
+      in->dst = reg;
+      if (!movlike && nops > 1)
+        add_src(in, reg);
+    } else {
+      add_src(in, reg);
+    }
+  }
+
+  // zeroing idioms break the dependency
+  if (nops == 2 && in->dst >= 0 && !strcmp(ops[0], ops[1]) &&
+      (prefix(mn, "xor") || prefix(mn, "sub") || prefix(mn, "pxor") ||
+       prefix(mn, "vpxor") || prefix(mn, "xorp")))
+    in->nsrc = 0;
+
+  // one operand integer divide writes %rax (quotient)
+  if (nops == 1 && (in->flags & F_DIV) && in->dst < 0) {
+    add_src(in, 0);
+    in->dst = 0;
+  }
+}
+
+// GNU arm64 syntax: "mnemonic dst, src, ..."
+static void decode_arm64(struct insn *in, char *mn, char *opstr)
+{
+  char *ops[6];
+  int nops, nodst;
+
+  if (!strcmp(mn, "sdiv") || !strcmp(mn, "udiv") || !strcmp(mn, "fdiv") ||
+      !strcmp(mn, "fsqrt"))
+    in->flags |= F_DIV;
+  if (!strcmp(mn, "bl") || !strcmp(mn, "blr"))
+    in->flags |= F_CALL;
+  if (!strcmp(mn, "ret") || !strcmp(mn, "b") || !strcmp(mn, "br") ||
+      !strcmp(mn, "brk"))
+    in->flags |= F_END;
+
+  nops = split_ops(opstr, ops, 6);
+
+  if (prefix(mn, "b.") || !strcmp(mn, "cbz") || !strcmp(mn, "cbnz") ||
+      !strcmp(mn, "tbz") || !strcmp(mn, "tbnz")) {
+    in->flags |= F_CBR;
+    if (nops > 0 && isxdigit(ops[nops-1][0]))
+      in->target = strtoull(ops[nops-1], NULL, 16);
+    if (in->target && in->target <= in->addr)
+      in->flags |= F_BACK;
+    if (nops > 1)
+      add_src(in, arm64_reg(ops[0], strcspn(ops[0], " ")));
+    return;
+  }
+
+  if (prefix(mn, "ld")) {
+    in->flags |= F_LOAD;
+    if (nops < 2 || (!strchr(ops[nops-1], '[') && !strchr(ops[1], '[')))
+      in->flags |= F_PCREL; /* literal pool */
+  }
+  nodst = prefix(mn, "st") || prefix(mn, "cmp") || prefix(mn, "cmn") ||
+    prefix(mn, "tst") || prefix(mn, "fcmp") || prefix(mn, "ccmp") ||
+    prefix(mn, "prfm") || mn[0] == 'b' || !strcmp(mn, "ret");
+
+  for (int i = 0; i < nops; i++) {
+    int inside = strchr(ops[i], '[') != NULL;
+    char *p = ops[i];
+    while (*p) {
+      int len;
+      while (*p && !isalnum(*p) && *p != '#')
+        p++;
+      if (*p == '#') { /* immediate */
+        p += strcspn(p, ",]");
+        continue;
+      }
+      len = strcspn(p, " ,[]!{}");
+      int reg = arm64_reg(p, len);
+      if (i == 0 && !nodst && !inside) {
+        in->dst = reg;
+      } else {
+        add_src(in, reg);
+        if (inside && reg >= 0 && in->naddr < 3)
+          in->addr_reg[in->naddr++] = reg;
+      }
+      p += len;
+    }
+  }
+  if (in->naddr == 1 && (in->addr_reg[0] == 31 || in->addr_reg[0] == 29))
+    in->flags |= F_STACK; /* sp or frame pointer */
+}
+
+// Parse one objdump line "  addr:\tmnemonic operands". Returns 0 if the
+// line is not an instruction.
+static int decode(struct insn *in, char *line, arch_t arch)
+{
+  char *p, *mn;
+
+  memset(in, 0, sizeof(*in));
+  in->dst = -1;
+
+  in->addr = strtoull(line, &p, 16);
+  if (p == line || *p != ':')
+    return 0;
+  p++;
+  while (isspace(*p))
+    p++;
+  if (!*p || *p == '(')  /* "(bad)" */
+    return 0;
+
+  // strip comments and symbolic targets
+  p[strcspn(p, arch == ARCH_X86 ? "#<" : "/<")] = 0;
+  for (char *e = p + strlen(p); e > p && isspace(e[-1]); )
+    *--e = 0;
+
+  // skip instruction prefixes
+  for (;;) {
+    mn = p;
+    p += strcspn(p, " \t");
+    if (*p)
+      *p++ = 0;
+    if (arch == ARCH_X86 &&
+        (!strcmp(mn, "lock") || prefix(mn, "rep") || !strcmp(mn, "cs") ||
+         !strcmp(mn, "ds") || !strcmp(mn, "data16") || !strcmp(mn, "bnd") ||
+         !strcmp(mn, "notrack") || !strcmp(mn, "addr32")) && *p)
+      continue;
+    break;
+  }
+
+  if (arch == ARCH_X86)
+    decode_x86(in, mn, p);
+  else
+    decode_arm64(in, mn, p);
+  return 1;
+}
+
+// ---------------------------------------------------------------------------
+// Propagate load depth (# of loads a value went through) over insns
+// [from, to] and set `mark' on loads whose address has depth >= min_dep.
+// Stack reloads are not counted as a level of indirection. With gen == 0
+// a load only forwards the depth of its address, which tracks the values
+// carried around a loop.
+static void taint_pass(struct insn *v, int from, int to, char *depth,
+                       int gen, int min_dep, int mark)
+{
+  for (int i = from; i <= to; i++) {
+    struct insn *in = &v[i];
+    int t = 0, a = 0;
+
+    if (in->flags & (F_CALL | F_END)) {
+      memset(depth, 0, MAX_REGS);
+      continue;
+    }
+    for (int k = 0; k < in->nsrc; k++)
+      t = MAX(t, depth[(int)in->src[k]]);
+    if ((in->flags & (F_LOAD | F_STACK)) == F_LOAD) {
+      for (int k = 0; k < in->naddr; k++)
+        a = MAX(a, depth[(int)in->addr_reg[k]]);
+      if (a >= min_dep)
+        in->flags |= mark;
+      if (gen)
+        t = MAX(t, MIN(a + 1, 127));
+    }
+    if (in->dst >= 0)
+      depth[(int)in->dst] = t;
+  }
+}
+
+// Mark the tight, call-free loop [from, to] and flag its loads whose
+// address is carried from a load in the previous iteration (pointer
+// chasing). Returns 0 if [from, to] is not such a loop.
+static int loop_pass(struct insn *v, int from, int to)
+{
+  char carry[MAX_REGS] = { 0 };
+
+  for (int i = from; i <= to; i++)
+    if (v[i].flags & (F_CALL | F_END))
+      return 0;
+  for (int i = from; i <= to; i++)
+    v[i].flags |= F_LOOP;
+  taint_pass(v, from, to, carry, 1, MAX_REGS, 0);
+  for (int r = 0; r < MAX_REGS; r++)
+    carry[r] = carry[r] > 0;
+  taint_pass(v, from, to, carry, 0, 1, F_CARRY);
+  return 1;
+}
+
+static int find_insn(struct insn *v, int n, uint64_t addr)
+{
+  int lo = 0, hi = n - 1;
+
+  while (lo <= hi) {
+    int mid = (lo + hi) / 2;
+    if (v[mid].addr == addr)
+      return mid;
+    if (v[mid].addr < addr)
+      lo = mid + 1;
+    else
+      hi = mid - 1;
+  }
+  return -1;
+}
+
+static int analyze(const char *path, const char *func, struct insn *v, int n)
+{
+  char depth[MAX_REGS] = { 0 };
+  int lat[MAX_REGS] = { 0 };
+  int *score, *loop, *region, hits = 0;
+
+  if (n == 0)
+    return 0;
+
+  // loop[i]: head of the tight loop containing i (or -1); for the back
+  // edge b, loop[b] <= i <= b. region[i]: first insn of the straight-line
+  // region (code since the last ret/jmp) containing i.
+  score = malloc((n + 1) * sizeof(*score));
+  loop = malloc(n * sizeof(*loop));
+  region = malloc(n * sizeof(*region));
+  for (int i = 0; i < n; i++) {
+    loop[i] = -1;
+    region[i] = (i > 0 && !(v[i-1].flags & F_END)) ? region[i-1] : i;
+  }
+
+  // straight-line loads need two levels of indirection to count as a
+  // chain; inside loops only loop-carried pointer chasing counts.
+  for (int i = 0; i < n; i++) {
+    taint_pass(v, i, i, depth, 1, 2, F_DEP);
+    if ((v[i].flags & (F_CBR | F_BACK)) == (F_CBR | F_BACK)) {
+      int t = find_insn(v, n, v[i].target);
+      if (t >= 0 && i - t < TIGHT_LOOP && loop_pass(v, t, i))
+        for (int k = t; k <= i; k++)
+          loop[k] = t;
+    }
+  }
+
+  // score[i] = sum of long-latency weights of v[0..i-1]; v[i].lat = the
+  // weight of the longest chain of divides and loads producing v[i].
+  score[0] = 0;
+  for (int i = 0; i < n; i++) {
+    int w = 0, t = 0;
+
+    if (v[i].flags & F_CARRY || (v[i].flags & (F_DIV | F_LOOP)) == (F_DIV | F_LOOP))
+      w = config.loop_weight;
+    else if (v[i].flags & (F_DIV | F_DEP))
+      w = 1;
+    score[i+1] = score[i] + w;
+
+    if (v[i].flags & (F_CALL | F_END)) {
+      memset(lat, 0, sizeof(lat));
+      continue;
+    }
+    for (int k = 0; k < v[i].nsrc; k++)
+      t = MAX(t, lat[(int)v[i].src[k]]);
+    if (!w && (v[i].flags & (F_LOAD | F_STACK)) == F_LOAD)
+      w = 1;
+    v[i].lat = MIN(t + w, 1 << 20);
+    if (v[i].dst >= 0)
+      lat[(int)v[i].dst] = v[i].lat;
+  }
+
+  for (int b = 0; b < n; b++) {
+    int chain, burst, l, start, end;
+
+    // a guard inside a tight loop would be fed by that loop's own chain
+    if ((v[b].flags & (F_CBR | F_BACK)) != F_CBR || loop[b] >= 0)
+      continue;
+    // the condition (flag setter or branch operand) must wait for the chain
+    for (l = b; l > region[b] && (v[l].flags & F_CBR) && !v[l].lat; l--)
+      ;
+    chain = v[l].lat;
+    if (chain < config.chain_min)
+      continue;
+
+    for (l = b + 1; l < n && l <= b + config.load_win && region[l] == region[b]; l++)
+      if ((v[l].flags & (F_LOAD | F_PCREL)) == F_LOAD)
+        break;
+    if (l >= n || l > b + config.load_win || region[l] != region[b])
+      continue;
+
+    start = l;
+    for (end = start; end + 1 < n && end < l + config.burst_win &&
+           region[end + 1] == region[l]; end++)
+      ;
+    burst = score[end + 1] - score[start + 1];
+    if (burst < config.burst_min)
+      continue;
+
+    debug(SUCCESS, "%s: <%s> guard 0x%" PRIx64 " (chain %d), load 0x%" PRIx64
+          " (burst %d)\n", path, func, v[b].addr, chain, v[l].addr, burst);
+    hits++;
+    b = start; // one report per gadget
+  }
+
+  free(region);
+  free(loop);
+  free(score);
+  return hits;
+}
+
+// ---------------------------------------------------------------------------
+// Disassemble one job and analyze its functions. Returns 0 on success,
+// objdump's wait status if it failed or -1 if it could not be run.
+static int run_job(struct job *jb, uint64_t *funcs, uint64_t *insns,
+                   uint64_t *hits)
+{
+  char start[32], stop[32];
+  char *argv[12];
+  int argc = 0, fd[2], status;
+  posix_spawn_file_actions_t fa;
+  pid_t pid;
+  FILE *fp;
+  char *line = NULL, func[256] = "";
+  size_t cap = 0;
+  struct insn *v = NULL;
+  int n = 0, max = 0;
+
+  argv[argc++] = "objdump";
+  argv[argc++] = "-d";
+  argv[argc++] = "-w";
+  argv[argc++] = "--no-show-raw-insn";
+  if (jb->section) {
+    snprintf(start, sizeof(start), "--start-address=0x%" PRIx64, jb->start);
+    snprintf(stop, sizeof(stop), "--stop-address=0x%" PRIx64, jb->stop);
+    argv[argc++] = "-j";
+    argv[argc++] = (char *)jb->section;
+    argv[argc++] = start;
+    argv[argc++] = stop;
+  }
+  argv[argc++] = (char *)jb->path;
+  argv[argc] = NULL;
+
+  // O_CLOEXEC: children spawned by other workers must not hold our pipe
+  if (pipe2(fd, O_CLOEXEC) < 0) {
+    debug(ERROR, "%s: pipe: %s\n", jb->path, strerror(errno));
+    return -1;
+  }
+  posix_spawn_file_actions_init(&fa);
+  posix_spawn_file_actions_adddup2(&fa, fd[1], STDOUT_FILENO);
+  posix_spawn_file_actions_addopen(&fa, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+  status = posix_spawnp(&pid, "objdump", &fa, NULL, argv, environ);
+  posix_spawn_file_actions_destroy(&fa);
+  close(fd[1]);
+  if (status != 0) {
+    debug(ERROR, "%s: objdump: %s\n", jb->path, strerror(status));
+    close(fd[0]);
+    return -1;
+  }
+
+  fp = fdopen(fd[0], "r");
+  while (getline(&line, &cap, fp) > 0) {
+    char *p;
+
+    line[strcspn(line, "\n")] = 0;
+    if (isxdigit(line[0]) && (p = strstr(line, " <")) != NULL) {
+      // function header: "0000000000001340 <transmit_bit>:"
+      if (n > 0) {
+        *hits += analyze(jb->path, func, v, n);
+        *funcs += 1;
+        *insns += n;
+      }
+      n = 0;
+      snprintf(func, sizeof(func), "%.*s", (int)strcspn(p + 2, ">"), p + 2);
+      continue;
+    }
+    if (!isspace(line[0]))
+      continue;
+    if (n == max) {
+      max = max ? max * 2 : 1024;
+      v = realloc(v, max * sizeof(*v));
+    }
+    if (decode(&v[n], line, jb->arch))
+      n++;
+  }
+  if (n > 0) {
+    *hits += analyze(jb->path, func, v, n);
+    *funcs += 1;
+    *insns += n;
+  }
+
+  fclose(fp);
+  free(line);
+  free(v);
+  if (waitpid(pid, &status, 0) < 0) {
+    debug(ERROR, "%s: waitpid: %s\n", jb->path, strerror(errno));
+    return -1;
+  }
+  return status;
+}
+
+static void *worker(void *dummy)
+{
+  uint64_t funcs = 0, insns = 0, hits = 0;
+  int i;
+
+  while ((i = __sync_fetch_and_add(&next_job, 1)) < n_jobs)
+    jobs[i].status = run_job(&jobs[i], &funcs, &insns, &hits);
+
+  __sync_fetch_and_add(&g_funcs, funcs);
+  __sync_fetch_and_add(&g_insns, insns);
+  __sync_fetch_and_add(&g_hits, hits);
+  return NULL;
+}
+
+// ---------------------------------------------------------------------------
+static void add_job(const char *path, const char *section, uint64_t start,
+                    uint64_t stop, arch_t arch)
+{
+  if (n_jobs == max_jobs) {
+    max_jobs = max_jobs ? max_jobs * 2 : 256;
+    jobs = realloc(jobs, max_jobs * sizeof(*jobs));
+  }
+  jobs[n_jobs++] = (struct job){ path, section, start, stop, arch, 0 };
+  g_bytes += stop - start;
+}
+
+// Cut point for text without (enough) symbols: the next 16 byte aligned
+// address behind int3/nop/ret padding, i.e. a likely function start, so
+// that objdump does not begin in the middle of an x86 instruction.
+static uint64_t pad_cut(const unsigned char *sec, uint64_t addr, uint64_t size,
+                        uint64_t cut, arch_t arch)
+{
+  uint64_t limit = MIN(cut + 4096, addr + size);
+
+  cut = (cut + 15) & ~(uint64_t)15;
+  if (arch != ARCH_X86)
+    return MIN(cut, addr + size);
+  for (uint64_t a = cut; a < limit; a += 16) {
+    unsigned char prev = sec[a - addr - 1];
+    if (prev == 0xcc || prev == 0x90 || prev == 0xc3)
+      return a;
+  }
+  return MIN(cut, addr + size);
+}
+
+static int cmp_u64(const void *p, const void *q)
+{
+  uint64_t a = *(const uint64_t *)p, b = *(const uint64_t *)q;
+  return (a > b) - (a < b);
+}
+
+// Class-independent view of the ELF headers we need.
+#define ELF_FIELD(is64, p, T, f) ((is64) ? ((Elf64_##T *)(p))->f : ((Elf32_##T *)(p))->f)
+
+// Split the executable sections of one ELF file into jobs. Chunks start at
+// function symbols so that objdump never begins in the middle of a function;
+// stripped text is cut into fixed size chunks at padding instead.
+static void plan_file(const char *path)
+{
+  struct stat st;
+  unsigned char *img;
+  int fd, is64;
+  size_t shoff, shentsize, shnum, shstrndx, symsz;
+  uint64_t *syms = NULL;
+  size_t n_syms = 0, max_syms = 0;
+  arch_t arch;
+  char *dup;
+  int first_job = n_jobs;
+
+  if ((fd = open(path, O_RDONLY)) < 0) {
+    debug(ERROR, "%s: %s\n", path, strerror(errno));
+    n_errors++;
+    return;
+  }
+  if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size < EI_NIDENT) {
+    close(fd);
+    return;
+  }
+  img = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (img == MAP_FAILED)
+    return;
+
+  if (memcmp(img, ELFMAG, SELFMAG) || img[EI_DATA] != ELFDATA2LSB ||
+      (img[EI_CLASS] != ELFCLASS32 && img[EI_CLASS] != ELFCLASS64))
+    goto out;
+  is64 = img[EI_CLASS] == ELFCLASS64;
+  if ((size_t)st.st_size < (is64 ? sizeof(Elf64_Ehdr) : sizeof(Elf32_Ehdr)))
+    goto out;
+
+  switch (ELF_FIELD(is64, img, Ehdr, e_machine)) {
+  case EM_X86_64:
+  case EM_386:
+    arch = ARCH_X86;
+    break;
+  case EM_AARCH64:
+    arch = ARCH_ARM64;
+    break;
+  default:
+    goto out;
+  }
+
+  shoff = ELF_FIELD(is64, img, Ehdr, e_shoff);
+  shentsize = ELF_FIELD(is64, img, Ehdr, e_shentsize);
+  shnum = ELF_FIELD(is64, img, Ehdr, e_shnum);
+  shstrndx = ELF_FIELD(is64, img, Ehdr, e_shstrndx);
+  if (shoff == 0 || shstrndx >= shnum ||
+      shentsize < (is64 ? sizeof(Elf64_Shdr) : sizeof(Elf32_Shdr)) ||
+      shoff + shnum * shentsize > (size_t)st.st_size)
+    goto out;
+  dup = strdup(path);
+  n_files++;
+#define SHDR(i) (img + shoff + (i) * shentsize)
+#define SH(i, f) ELF_FIELD(is64, SHDR(i), Shdr, f)
+
+  // collect function entry points
+  for (size_t i = 0; i < shnum; i++) {
+    if (SH(i, sh_type) != SHT_SYMTAB && SH(i, sh_type) != SHT_DYNSYM)
+      continue;
+    symsz = is64 ? sizeof(Elf64_Sym) : sizeof(Elf32_Sym);
+    if (SH(i, sh_offset) + SH(i, sh_size) > (size_t)st.st_size)
+      continue;
+    for (size_t off = 0; off + symsz <= SH(i, sh_size); off += symsz) {
+      unsigned char *s = img + SH(i, sh_offset) + off;
+      unsigned char info = ELF_FIELD(is64, s, Sym, st_info);
+      if (ELF64_ST_TYPE(info) != STT_FUNC || ELF_FIELD(is64, s, Sym, st_value) == 0)
+        continue;
+      if (n_syms == max_syms) {
+        max_syms = max_syms ? max_syms * 2 : 1024;
+        syms = realloc(syms, max_syms * sizeof(*syms));
+      }
+      syms[n_syms++] = ELF_FIELD(is64, s, Sym, st_value);
+    }
+  }
+  qsort(syms, n_syms, sizeof(*syms), cmp_u64);
+
+  size_t strtab = SH(shstrndx, sh_offset);
+  uint64_t text = 0;
+  for (size_t i = 0; i < shnum; i++) {
+    uint64_t addr = SH(i, sh_addr), size = SH(i, sh_size), start, cut;
+    size_t k = 0;
+
+    if (SH(i, sh_type) != SHT_PROGBITS || !(SH(i, sh_flags) & SHF_EXECINSTR) ||
+        size == 0 || strtab + SH(i, sh_name) >= (size_t)st.st_size)
+      continue;
+    if (ELF_FIELD(is64, img, Ehdr, e_type) == ET_REL) {
+      text += size; /* sections overlap at address 0, one job per file */
+      continue;
+    }
+
+    const char *name = strndup((char *)img + strtab + SH(i, sh_name),
+                               st.st_size - strtab - SH(i, sh_name));
+    start = addr;
+    while (start < addr + size) {
+      cut = start + config.chunk;
+      while (k < n_syms && syms[k] <= cut)
+        k++;
+      if (cut >= addr + size)
+        cut = addr + size;
+      else if (k < n_syms && syms[k] < MIN(cut + config.chunk, addr + size))
+        cut = syms[k]; /* first function after the chunk size */
+      else if (SH(i, sh_offset) + size <= (size_t)st.st_size)
+        cut = pad_cut(img + SH(i, sh_offset), addr, size, cut, arch);
+      add_job(dup, name, start, cut, arch);
+      start = cut;
+    }
+  }
+  if (text)
+    add_job(dup, NULL, 0, text, arch);
+  if (n_jobs == first_job)
+    free(dup);
+#undef SH
+#undef SHDR
+
+out:
+  free(syms);
+  munmap(img, st.st_size);
+}
+
+static int plan_ftw(const char *path, const struct stat *sb, int type,
+                    struct FTW *ftw)
+{
+  if (type == FTW_F)
+    plan_file(path);
+  else if (type == FTW_NS || type == FTW_DNR) {
+    debug(ERROR, "%s: cannot %s\n", path, type == FTW_NS ? "stat" : "read directory");
+    n_errors++;
+  }
+  return 0;
+}
+
+static void usage(const char *prog)
+{
+  fprintf(stderr,
+          "usage: %s [options] file|dir ...\n"
+          "  -j N   worker threads (default: # online cpus)\n"
+          "  -c N   minimum latency of the chain feeding the guard (default %d)\n"
+          "  -s N   secret load window after the guard (default %d insns)\n"
+          "  -t N   burst window after the secret load (default %d insns)\n"
+          "  -n N   minimum burst score (default %d)\n"
+          "  -L N   score of a divide/dependent load inside a loop (default %d)\n"
+          "  -k N   KB of text per objdump invocation (default %zu)\n"
+          "  -q     only print errors and the summary\n",
+          prog, config.chain_min, config.load_win,
+          config.burst_win, config.burst_min, config.loop_weight,
+          config.chunk >> 10);
+}
+
+int main(int argc, char *argv[])
+{
+  int opt, n_threads = sysconf(_SC_NPROCESSORS_ONLN);
+  int quiet = 0;
+  uint64_t t_start, t_end;
+  pthread_t *threads;
+  double secs;
+
+  while ((opt = getopt(argc, argv, "j:c:s:t:n:L:k:q")) != -1) {
+    switch(opt) {
+    case 'j': n_threads = strtol(optarg, NULL, 0); break;
+    case 'c': config.chain_min = strtol(optarg, NULL, 0); break;
+    case 's': config.load_win = strtol(optarg, NULL, 0); break;
+    case 't': config.burst_win = strtol(optarg, NULL, 0); break;
+    case 'n': config.burst_min = strtol(optarg, NULL, 0); break;
+    case 'L': config.loop_weight = strtol(optarg, NULL, 0); break;
+    case 'k': config.chunk = (size_t)strtol(optarg, NULL, 0) << 10; break;
+    case 'q': quiet = 1; break;
+    default:
+      usage(argv[0]);
+      return -1;
+    }
+  }
+  if (optind >= argc || n_threads < 1 || config.chunk == 0) {
+    usage(argv[0]);
+    return -1;
+  }
+
+  t_start = now_in_ns();
+  for (int i = optind; i < argc; i++)
+    if (nftw(argv[i], plan_ftw, 64, FTW_PHYS) < 0) {
+      debug(ERROR, "%s: %s\n", argv[i], strerror(errno));
+      n_errors++;
+    }
+
+  dbg = !quiet;
+  threads = malloc(n_threads * sizeof(*threads));
+  for (int i = 0; i < n_threads; i++)
+    pthread_create(&threads[i], NULL, worker, NULL);
+  for (int i = 0; i < n_threads; i++)
+    pthread_join(threads[i], NULL);
+  free(threads);
+  t_end = now_in_ns();
+  dbg = 1;
+
+  // A file objdump failed on (e.g. aarch64 code and an objdump built for
+  // x86 only) is not scanned: report it once and drop its bytes.
+  for (int i = 0, j; i < n_jobs; i = j) {
+    int status = 0;
+
+    for (j = i; j < n_jobs && jobs[j].path == jobs[i].path; j++)
+      if (jobs[j].status && !status)
+        status = jobs[j].status;
+    if (!status)
+      continue;
+    if (status > 0)
+      debug(ERROR, "%s: objdump failed (%s %d), not scanned\n", jobs[i].path,
+            WIFSIGNALED(status) ? "signal" : "exit status",
+            WIFSIGNALED(status) ? WTERMSIG(status) : WEXITSTATUS(status));
+    for (int k = i; k < j; k++)
+      g_bytes -= jobs[k].stop - jobs[k].start;
+    n_files--;
+    n_errors++;
+  }
+
+  secs = (double)(t_end - t_start) / 1000000000;
+  debug(INFO, "Scanned %d files, %" PRIu64 " functions, %" PRIu64
+        " insns (%.2f MB text) with %d threads in %.2f s\n",
+        n_files, g_funcs, g_insns, (double)g_bytes / (1 << 20), n_threads, secs);
+  debug(INFO, "Scan rate: %.2f MB/s\n", (double)g_bytes / (1 << 20) / secs);
+  debug(g_hits ? SUCCESS : INFO, "Gadgets found: %" PRIu64 "\n", g_hits);
+  if (n_errors)
+    debug(ERROR, "Errors: %d (see above), results are incomplete\n", n_errors);
+
+  return n_errors ? -1 : 0;
+}